@@ -2,17 +2,64 @@
 #define PCXFORMAT_H
 
 #include <algorithm>
+#include <atomic>
 #include <set>
 #include <cmath>
+#include <climits>
 #include <map>
+#include <thread>
 #include <image_types/PCX.h>
 
+enum class DitheringMode {
+    NONE,
+    ORDERED,
+    FLOYD_STEINBERG,
+};
 
 class PCXFormat {
 protected:
+    class PaletteLookup {
+        // Channels are kept as separate padded arrays so the distance loop in nearest() vectorizes.
+        static constexpr int32_t PADDING_COLOR = 1023;
+        static constexpr uint32_t LANES = 8;
+        std::vector<int32_t> red;
+        std::vector<int32_t> green;
+        std::vector<int32_t> blue;
+
+    public:
+        explicit PaletteLookup(const std::vector<RGB> &palette) {
+            if (palette.empty() || palette.size() > 256)
+                throw std::runtime_error("Palette size must be between 1 and 256!");
+            uint32_t paddedSize = (palette.size() + LANES - 1) / LANES * LANES;
+            red = green = blue = std::vector<int32_t>(paddedSize, PADDING_COLOR);
+            for (uint32_t i = 0; i < palette.size(); ++i) {
+                red[i] = palette[i].red;
+                green[i] = palette[i].green;
+                blue[i] = palette[i].blue;
+            }
+        }
+
+        // Squared distance and index are packed into one key, so the search is a plain min-reduction.
+        [[nodiscard]] uint8_t nearest(int32_t r, int32_t g, int32_t b) const {
+            int32_t best = INT32_MAX;
+            const int32_t size = static_cast<int32_t>(red.size());
+            for (int32_t i = 0; i < size; ++i) {
+                int32_t dr = r - red[i];
+                int32_t dg = g - green[i];
+                int32_t db = b - blue[i];
+                best = std::min(best, ((dr * dr + dg * dg + db * db) << 8) | i);
+            }
+            return static_cast<uint8_t>(best & 0xFF);
+        }
+    };
+
+    static constexpr int32_t ORDERED_DITHER_SPREAD = 64;
+    static constexpr uint32_t FLOYD_STEINBERG_PUBLISH_STEP = 32;
+
     uint8_t bitsPerPixel{};
     uint8_t colorPlanes{};
     PCX::PCXHeader headerTemplate{};
+    DitheringMode dithering{};
 
     static RGB convertRGBAToRGB(const RGBA& color){
         return RGB{color.red,color.green, color.blue};
@@ -132,7 +179,131 @@ protected:
         return relation;
     }
 
-    PCXFormat(uint8_t bitsPerPixel, uint8_t colorPlanes) : bitsPerPixel(bitsPerPixel), colorPlanes(colorPlanes) {
+    static int32_t clampChannel(int32_t value) {
+        return std::clamp(value, 0, 255);
+    }
+
+    static int32_t getOrderedDitherOffset(uint32_t row, uint32_t column) {
+        static const int32_t BAYER_4X4[4][4] = {
+                {0,  8,  2,  10},
+                {12, 4,  14, 6},
+                {3,  11, 1,  9},
+                {15, 7,  13, 5},
+        };
+        return (2 * BAYER_4X4[row & 3][column & 3] - 15) * ORDERED_DITHER_SPREAD / 32;
+    }
+
+    template<typename IndexWriter>
+    static void remapOrderedDithering(const std::vector<RGBA> &line, uint32_t row, const PaletteLookup &lookup,
+                                      IndexWriter &&writeIndex) {
+        for (uint32_t column = 0; column < line.size(); ++column) {
+            int32_t offset = getOrderedDitherOffset(row, column);
+            writeIndex(row, column, lookup.nearest(clampChannel(line[column].red + offset),
+                                                   clampChannel(line[column].green + offset),
+                                                   clampChannel(line[column].blue + offset)));
+        }
+    }
+
+    template<typename IndexWriter>
+    static void remapOrderedDithering(const std::vector<std::vector<RGBA>> &rgbaPixels, const PaletteLookup &lookup,
+                                      IndexWriter &&writeIndex) {
+        for (uint32_t row = 0; row < rgbaPixels.size(); ++row)
+            remapOrderedDithering(rgbaPixels[row], row, lookup, writeIndex);
+    }
+
+    // Rows are processed as a wavefront: row N may handle a column once row N - 1 is two columns ahead of it,
+    // because that is the last point where Floyd-Steinberg pushes error into it. Progress is published every
+    // FLOYD_STEINBERG_PUBLISH_STEP columns, so a row trails the one above by at most that many columns plus two.
+    // Rows are dealt to the workers round-robin and share a ring of error lines, so the result does not depend
+    // on the number of threads.
+    template<typename IndexWriter>
+    static void remapFloydSteinbergDithering(const std::vector<std::vector<RGBA>> &rgbaPixels,
+                                             const PaletteLookup &lookup, const std::vector<RGB> &palette,
+                                             IndexWriter &&writeIndex, uint32_t threadCount = 0) {
+        const uint32_t height = rgbaPixels.size();
+        const uint32_t width = rgbaPixels[0].size();
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        threadCount = std::min(threadCount, height);
+
+        const uint32_t ringSize = threadCount + 1;
+        std::vector<std::vector<int32_t>> errorLines(ringSize, std::vector<int32_t>(3 * (width + 2)));
+        std::vector<std::atomic<uint32_t>> progress(height);
+        for (auto &rowProgress: progress)
+            rowProgress.store(0, std::memory_order_relaxed);
+
+        auto processRow = [&](uint32_t row) {
+            const std::vector<RGBA> &line = rgbaPixels[row];
+            int32_t *current = errorLines[row % ringSize].data();
+            int32_t *next = errorLines[(row + 1) % ringSize].data();
+            int32_t carry[3] = {0, 0, 0};
+            uint32_t available = row > 0 ? 0 : width;
+
+            for (uint32_t column = 0; column < width; ++column) {
+                uint32_t required = std::min(width, column + 2);
+                while (available < required) {
+                    available = progress[row - 1].load(std::memory_order_acquire);
+                    if (available < required)
+                        std::this_thread::yield();
+                }
+                if (column == 0)
+                    std::fill(next, next + 6, 0);
+                const int32_t source[3] = {line[column].red, line[column].green, line[column].blue};
+                int32_t wanted[3];
+                for (uint32_t channel = 0; channel < 3; ++channel) {
+                    int32_t inherited = row > 0 ? current[3 * (column + 1) + channel] : 0;
+                    wanted[channel] = clampChannel(source[channel] + (carry[channel] + inherited) / 16);
+                }
+                uint8_t index = lookup.nearest(wanted[0], wanted[1], wanted[2]);
+                writeIndex(row, column, index);
+
+                const int32_t chosen[3] = {palette[index].red, palette[index].green, palette[index].blue};
+                for (uint32_t channel = 0; channel < 3; ++channel) {
+                    int32_t error = wanted[channel] - chosen[channel];
+                    carry[channel] = 7 * error;
+                    next[3 * (column + 2) + channel] = error;
+                    next[3 * (column + 1) + channel] += 5 * error;
+                    next[3 * column + channel] += 3 * error;
+                }
+                if ((column + 1) % FLOYD_STEINBERG_PUBLISH_STEP == 0)
+                    progress[row].store(column + 1, std::memory_order_release);
+            }
+            progress[row].store(width, std::memory_order_release);
+        };
+
+        if (threadCount == 1) {
+            for (uint32_t row = 0; row < height; ++row)
+                processRow(row);
+            return;
+        }
+        std::vector<std::thread> workers;
+        for (uint32_t worker = 0; worker < threadCount; ++worker)
+            workers.emplace_back([&, worker]() {
+                for (uint32_t row = worker; row < height; row += threadCount)
+                    processRow(row);
+            });
+        for (auto &thread: workers)
+            thread.join();
+    }
+
+    static void encodeRunLength(const uint8_t *data, uint32_t size, std::vector<uint8_t> &encodedData) {
+        uint32_t currentByte = 0;
+        while (currentByte < size) {
+            uint8_t repeat = 1;
+            for (uint32_t i = currentByte + 1; i < size && data[currentByte] == data[i] && repeat < 63; ++i)
+                ++repeat;
+            if (repeat == 1 && (data[currentByte] & 0xC0) != 0xC0) {
+                encodedData.push_back(data[currentByte]);
+            } else {
+                encodedData.push_back(0xC0 + repeat);
+                encodedData.push_back(data[currentByte]);
+            }
+            currentByte += repeat;
+        }
+    }
+
+    PCXFormat(uint8_t bitsPerPixel, uint8_t colorPlanes, DitheringMode dithering = DitheringMode::NONE)
+            : bitsPerPixel(bitsPerPixel), colorPlanes(colorPlanes), dithering(dithering) {
         headerTemplate.manufacturer = 0x0A;
         headerTemplate.version = 5;
         headerTemplate.encoding = 1;
@@ -151,21 +322,7 @@ public:
     std::vector<uint8_t> encodeImageData(const std::vector<std::vector<RGBA>> &rgbaPixels) {
         std::vector<uint8_t> encodedImageData;
         std::vector<uint8_t> imageData = getImageData(rgbaPixels);
-
-        uint32_t currentByte = 0;
-        while (currentByte < imageData.size()) {
-            uint8_t repeat = 1;
-            for (uint32_t i = currentByte + 1;
-                 i < imageData.size() && imageData[currentByte] == imageData[i] && repeat < 63; ++i)
-                ++repeat;
-            if (repeat == 1 && (imageData[currentByte] & 0xC0) != 0xC0) {
-                encodedImageData.push_back(imageData[currentByte]);
-            } else {
-                encodedImageData.push_back(0xC0 + repeat);
-                encodedImageData.push_back(imageData[currentByte]);
-            }
-            currentByte += repeat;
-        }
+        encodeRunLength(imageData.data(), imageData.size(), encodedImageData);
 
         auto palette = get256PaletteData();
         encodedImageData.insert(encodedImageData.end(), palette.begin(), palette.end());
@@ -17,29 +17,39 @@ protected:
     }
 
     std::vector<uint8_t> getImageData(const std::vector<std::vector<RGBA>> &rgbaPixels) override {
-        auto relation = medianCutGetRelation(convertPixelMatrixToVector(rgbaPixels),16);
         auto palette = medianCutGetPalette(convertPixelMatrixToVector(rgbaPixels),16);
-        std::map<RGB,uint32_t> paletteMap;
-        for (uint32_t i = 0; i < palette.size();++i)
-            paletteMap[palette[i]]=i;
-
         uint16_t bytesPerLine = (4 * rgbaPixels[0].size()+4)/8;
         std::vector<uint8_t> imageData(bytesPerLine*rgbaPixels.size());
-        for (uint32_t row = 0; row < rgbaPixels.size(); ++row) {
-            for (uint32_t pixel = 0; pixel < rgbaPixels[row].size(); ++pixel){
-                uint32_t currentByte = row*bytesPerLine+pixel/2;
-                if ((pixel&1)==0)
-                    imageData[currentByte]+=paletteMap[convertRGBAToRGB(relation[rgbaPixels[row][pixel]])]<<4;
-                else
-                    imageData[currentByte]+=paletteMap[convertRGBAToRGB(relation[rgbaPixels[row][pixel]])];
-            }
+        auto writeIndex = [&imageData, bytesPerLine](uint32_t row, uint32_t pixel, uint8_t index) {
+            uint32_t currentByte = row*bytesPerLine+pixel/2;
+            if ((pixel&1)==0)
+                imageData[currentByte]+=index<<4;
+            else
+                imageData[currentByte]+=index;
+        };
+
+        if (this->dithering == DitheringMode::ORDERED) {
+            remapOrderedDithering(rgbaPixels, PaletteLookup(palette), writeIndex);
+            return imageData;
         }
+        if (this->dithering == DitheringMode::FLOYD_STEINBERG) {
+            remapFloydSteinbergDithering(rgbaPixels, PaletteLookup(palette), palette, writeIndex);
+            return imageData;
+        }
+
+        auto relation = medianCutGetRelation(convertPixelMatrixToVector(rgbaPixels),16);
+        std::map<RGB,uint32_t> paletteMap;
+        for (uint32_t i = 0; i < palette.size();++i)
+            paletteMap[palette[i]]=i;
+        for (uint32_t row = 0; row < rgbaPixels.size(); ++row)
+            for (uint32_t pixel = 0; pixel < rgbaPixels[row].size(); ++pixel)
+                writeIndex(row, pixel, paletteMap[convertRGBAToRGB(relation[rgbaPixels[row][pixel]])]);
 
         return imageData;
     }
 
 public:
-    PCXPalette16Color() : PCXFormat(4, 1) {}
+    explicit PCXPalette16Color(DitheringMode dithering = DitheringMode::NONE) : PCXFormat(4, 1, dithering) {}
 
     PCX::PCXHeader generateHeader(const std::vector<std::vector<RGBA>> &rgbaPixels) override {
         PCXPalette16Color::validatePixelMatrix(rgbaPixels);
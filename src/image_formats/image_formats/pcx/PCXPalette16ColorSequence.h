@@ -0,0 +1,131 @@
+#ifndef PCXPALETTE16COLORSEQUENCE_H
+#define PCXPALETTE16COLORSEQUENCE_H
+
+#include <image_formats/pcx/PCXPalette16Color.h>
+
+// Encodes a sequence of equally sized frames. Every scanline is hashed; while the previous palette fits the
+// changed scanlines no worse than it fit the frame it was built from (plus the tolerance), unchanged scanlines
+// reuse their previously encoded RLE bytes and only changed scanlines are remapped and encoded again.
+class PCXPalette16ColorSequence : public PCXPalette16Color {
+private:
+    uint32_t paletteTolerance;
+    std::vector<RGB> palette;
+    uint32_t paletteError{};
+    std::vector<uint64_t> scanlineHashes;
+    std::vector<std::vector<uint8_t>> encodedScanlines;
+    uint32_t frameWidth{};
+    uint32_t changedScanlines{};
+
+    static uint64_t hashScanline(const std::vector<RGBA> &line) {
+        uint64_t hash = 0xCBF29CE484222325;
+        for (const auto &color: line) {
+            uint32_t word;
+            memcpy(&word, &color, sizeof(uint32_t));
+            hash = (hash ^ word) * 0x100000001B3;
+        }
+        return hash;
+    }
+
+    uint32_t getScanlineError(const std::vector<RGBA> &line, const PaletteLookup &lookup) const {
+        uint32_t maxDistance = 0;
+        for (const auto &color: line) {
+            const RGB &nearest = this->palette[lookup.nearest(color.red, color.green, color.blue)];
+            int32_t dr = color.red - nearest.red;
+            int32_t dg = color.green - nearest.green;
+            int32_t db = color.blue - nearest.blue;
+            maxDistance = std::max(maxDistance, uint32_t(dr * dr + dg * dg + db * db));
+        }
+        return maxDistance;
+    }
+
+    bool paletteFits(const std::vector<RGBA> &line, const PaletteLookup &lookup) const {
+        uint32_t allowedDistance = this->paletteError + this->paletteTolerance;
+        return getScanlineError(line, lookup) <= allowedDistance * allowedDistance;
+    }
+
+    std::vector<uint8_t> encodeScanline(const std::vector<RGBA> &line, uint32_t row, const PaletteLookup &lookup) {
+        uint16_t bytesPerLine = (4 * line.size()+4)/8;
+        std::vector<uint8_t> lineData(bytesPerLine);
+        auto writeIndex = [&lineData](uint32_t, uint32_t pixel, uint8_t index) {
+            if ((pixel&1)==0)
+                lineData[pixel/2]+=index<<4;
+            else
+                lineData[pixel/2]+=index;
+        };
+        if (this->dithering == DitheringMode::ORDERED)
+            remapOrderedDithering(line, row, lookup, writeIndex);
+        else
+            for (uint32_t pixel = 0; pixel < line.size(); ++pixel)
+                writeIndex(row, pixel, lookup.nearest(line[pixel].red, line[pixel].green, line[pixel].blue));
+
+        std::vector<uint8_t> encodedLine;
+        encodeRunLength(lineData.data(), lineData.size(), encodedLine);
+        return encodedLine;
+    }
+
+    PCX::PCXHeader generateSequenceHeader() const {
+        PCX::PCXHeader header = this->headerTemplate;
+        header.xMax = this->frameWidth - 1;
+        header.yMax = this->scanlineHashes.size() - 1;
+        header.bytesPerLine = (4 * this->frameWidth+4)/8;
+        memcpy(header.palette, &this->palette[0], std::min(sizeof(header.palette), this->palette.size() * sizeof(RGB)));
+        return header;
+    }
+
+public:
+    explicit PCXPalette16ColorSequence(uint32_t paletteTolerance = 24, DitheringMode dithering = DitheringMode::NONE)
+            : PCXPalette16Color(dithering), paletteTolerance(paletteTolerance) {
+        if (dithering == DitheringMode::FLOYD_STEINBERG)
+            throw std::runtime_error("Floyd-Steinberg dithering is not supported for sequences!");
+    }
+
+    std::vector<char> encodeFrame(const std::vector<std::vector<RGBA>> &rgbaPixels) {
+        PCXPalette16ColorSequence::validatePixelMatrix(rgbaPixels);
+        std::vector<uint64_t> hashes(rgbaPixels.size());
+        for (uint32_t row = 0; row < rgbaPixels.size(); ++row)
+            hashes[row] = hashScanline(rgbaPixels[row]);
+
+        bool reusePalette = !this->palette.empty() && this->frameWidth == rgbaPixels[0].size() &&
+                            this->scanlineHashes.size() == rgbaPixels.size();
+        if (reusePalette) {
+            PaletteLookup lookup(this->palette);
+            for (uint32_t row = 0; row < rgbaPixels.size() && reusePalette; ++row)
+                if (hashes[row] != this->scanlineHashes[row])
+                    reusePalette = paletteFits(rgbaPixels[row], lookup);
+        }
+        if (!reusePalette) {
+            this->palette = medianCutGetPalette(convertPixelMatrixToVector(rgbaPixels),16);
+            PaletteLookup lookup(this->palette);
+            uint32_t frameError = 0;
+            for (const auto &line: rgbaPixels)
+                frameError = std::max(frameError, getScanlineError(line, lookup));
+            this->paletteError = static_cast<uint32_t>(std::ceil(std::sqrt(frameError)));
+            this->frameWidth = rgbaPixels[0].size();
+            this->encodedScanlines = std::vector<std::vector<uint8_t>>(rgbaPixels.size());
+        }
+
+        PaletteLookup lookup(this->palette);
+        this->changedScanlines = 0;
+        for (uint32_t row = 0; row < rgbaPixels.size(); ++row) {
+            if (reusePalette && hashes[row] == this->scanlineHashes[row])
+                continue;
+            this->encodedScanlines[row] = encodeScanline(rgbaPixels[row], row, lookup);
+            ++this->changedScanlines;
+        }
+        this->scanlineHashes = std::move(hashes);
+
+        std::vector<char> image(PCX::PCX_HEADER_SIZE);
+        auto header = generateSequenceHeader();
+        memcpy(&image[0], &header, PCX::PCX_HEADER_SIZE);
+        for (const auto &line: this->encodedScanlines)
+            image.insert(image.end(), line.begin(), line.end());
+        return image;
+    }
+
+    [[nodiscard]] uint32_t getChangedScanlines() const {
+        return changedScanlines;
+    }
+};
+
+
+#endif
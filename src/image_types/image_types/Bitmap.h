@@ -1,7 +1,9 @@
 #ifndef BITMAP_H
 #define BITMAP_H
 
+#include <algorithm>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
 #include <stdexcept>
 #include <vector>
@@ -18,6 +20,15 @@ public:
         uint32_t offsetToImageData;
     };
 #pragma pack(pop)
+#pragma pack(push, 1)
+    struct BitmapCoreHeader {
+        uint32_t size;
+        uint16_t width;
+        uint16_t height;
+        uint16_t planes;
+        uint16_t bitCount;
+    };
+#pragma pack(pop)
 #pragma pack(push, 1)
     struct BitmapInfoHeader {
         uint32_t size;
@@ -33,6 +44,14 @@ public:
         uint32_t importantColorCount;
     };
 #pragma pack(pop)
+#pragma pack(push, 1)
+    struct BitmapColorMasks {
+        uint32_t red;
+        uint32_t green;
+        uint32_t blue;
+        uint32_t alpha;
+    };
+#pragma pack(pop)
 #pragma pack(push, 1)
     struct RGBQuad {
         uint8_t rgbBlue;
@@ -49,19 +68,60 @@ public:
     };
 #pragma pack(pop)
     static const int BITMAP_FILE_HEADER_SIZE = 14;
+    static const int BITMAP_CORE_HEADER_SIZE = 12;
     static const int BITMAP_INFO_HEADER_SIZE = 40;
+    static const int BITMAP_V2_INFO_HEADER_SIZE = 52;
+    static const int BITMAP_V3_INFO_HEADER_SIZE = 56;
+    static const int BITMAP_V4_HEADER_SIZE = 108;
+    static const int BITMAP_V5_HEADER_SIZE = 124;
     static const int BITMAP_RGBTRIPLE_SIZE = 3;
     static const int BITMAP_RGBQUAD_SIZE = 4;
+    static const uint32_t BI_RGB = 0;
+    static const uint32_t BI_BITFIELDS = 3;
+    static const uint32_t BI_ALPHABITFIELDS = 6;
 private:
+    // Extracts one channel of a BI_BITFIELDS pixel and scales it to 8 bits through a lookup table.
+    struct ChannelMask {
+        uint32_t mask{};
+        uint32_t shift{};
+        uint32_t reduce{};
+        uint32_t valueMask{};
+        uint8_t scale[256]{};
+
+        explicit ChannelMask(uint32_t mask) : mask(mask) {
+            if (mask == 0)
+                return;
+            while (((mask >> shift) & 1) == 0)
+                ++shift;
+            uint32_t bits = 0;
+            while (shift + bits < 32 && ((mask >> (shift + bits)) & 1) == 1)
+                ++bits;
+            reduce = bits > 8 ? bits - 8 : 0;
+            uint32_t maxValue = (1u << (bits - reduce)) - 1;
+            valueMask = maxValue;
+            for (uint32_t value = 0; value <= maxValue; ++value)
+                scale[value] = static_cast<uint8_t>((value * 255 + maxValue / 2) / maxValue);
+        }
+
+        [[nodiscard]] uint8_t extract(uint32_t pixel) const {
+            return mask == 0 ? 0 : scale[(((pixel & mask) >> shift) >> reduce) & valueMask];
+        }
+    };
+
     BitmapFileHeader fileHeader;
     BitmapInfoHeader infoHeader;
+    BitmapColorMasks colorMasks;
+    uint32_t headerSize{};
     int32_t width{};
     int32_t height{};
+    bool topDown{};
     std::vector<RGBQuad> palette;
     std::vector<std::vector<RGBA>> pixels;
 
 private:
     void fillFileHeader(const std::vector<char> &bytes) {
+        if (bytes.size() < BITMAP_FILE_HEADER_SIZE + sizeof(uint32_t))
+            throw std::runtime_error("Error: is not BMP file!");
         uint16_t fileType;
         memcpy(&fileType, &bytes[0], sizeof(uint16_t));
         if (fileType != 0x4D42)
@@ -70,64 +130,199 @@ private:
     }
 
     void fillInfoHeader(const std::vector<char> &bytes) {
-        uint32_t actualHeaderSize;
-        memcpy(&actualHeaderSize, &bytes[BITMAP_FILE_HEADER_SIZE], sizeof(uint32_t));
-        if (actualHeaderSize == BITMAP_INFO_HEADER_SIZE) {
+        memcpy(&headerSize, &bytes[BITMAP_FILE_HEADER_SIZE], sizeof(uint32_t));
+        if (bytes.size() < BITMAP_FILE_HEADER_SIZE + headerSize)
+            throw std::runtime_error("Error: BitmapInfoHeader is corrupted or version is not supported!");
+        if (headerSize == BITMAP_CORE_HEADER_SIZE) {
+            BitmapCoreHeader coreHeader{};
+            memcpy(&coreHeader, &bytes[BITMAP_FILE_HEADER_SIZE], BITMAP_CORE_HEADER_SIZE);
+            infoHeader.size = coreHeader.size;
+            infoHeader.width = coreHeader.width;
+            infoHeader.height = coreHeader.height;
+            infoHeader.planes = coreHeader.planes;
+            infoHeader.bitCount = coreHeader.bitCount;
+            infoHeader.compression = BI_RGB;
+        } else if (headerSize == BITMAP_INFO_HEADER_SIZE || headerSize == BITMAP_V2_INFO_HEADER_SIZE ||
+                   headerSize == BITMAP_V3_INFO_HEADER_SIZE || headerSize == BITMAP_V4_HEADER_SIZE ||
+                   headerSize == BITMAP_V5_HEADER_SIZE) {
             memcpy(&infoHeader, &bytes[BITMAP_FILE_HEADER_SIZE], BITMAP_INFO_HEADER_SIZE);
         } else {
             throw std::runtime_error("Error: BitmapInfoHeader is corrupted or version is not supported!");
         }
+
+        uint16_t bitCount = infoHeader.bitCount;
+        if (bitCount != 1 && bitCount != 4 && bitCount != 8 && bitCount != 16 && bitCount != 24 && bitCount != 32)
+            throw std::runtime_error("Unsupported format!");
+        bool bitfields = infoHeader.compression == BI_BITFIELDS || infoHeader.compression == BI_ALPHABITFIELDS;
+        if (infoHeader.compression != BI_RGB && !(bitfields && (bitCount == 16 || bitCount == 32)))
+            throw std::runtime_error("Unsupported format!");
+        if (infoHeader.width <= 0 || infoHeader.height == 0 || infoHeader.height == INT32_MIN)
+            throw std::runtime_error("Error: BitmapInfoHeader is corrupted or version is not supported!");
+    }
+
+    // BITMAPV2 and later headers carry the masks inside the header, the 40-byte one stores them right after it.
+    // BITMAPV2 has no alpha mask field, so a BI_ALPHABITFIELDS alpha mask follows that header as well.
+    uint32_t fillColorMasks(const std::vector<char> &bytes) {
+        colorMasks = {};
+        if (infoHeader.compression == BI_RGB) {
+            if (infoHeader.bitCount == 16)
+                colorMasks = {0x7C00, 0x03E0, 0x001F, 0};
+            else if (infoHeader.bitCount == 32)
+                colorMasks = {0x00FF0000, 0x0000FF00, 0x000000FF, 0};
+            return 0;
+        }
+        uint32_t maskCount = infoHeader.compression == BI_ALPHABITFIELDS ? 4 : 3;
+        uint32_t offsetToMasks = BITMAP_FILE_HEADER_SIZE + BITMAP_INFO_HEADER_SIZE;
+        uint32_t masksAfterHeader = 0;
+        if (headerSize == BITMAP_INFO_HEADER_SIZE)
+            masksAfterHeader = maskCount * sizeof(uint32_t);
+        else if (headerSize == BITMAP_V2_INFO_HEADER_SIZE)
+            masksAfterHeader = (maskCount - 3) * sizeof(uint32_t);
+        else
+            maskCount = 4;
+        if (bytes.size() < offsetToMasks + maskCount * sizeof(uint32_t))
+            throw std::runtime_error("Error: bitfield masks are corrupted!");
+        memcpy(&colorMasks, &bytes[offsetToMasks], maskCount * sizeof(uint32_t));
+        for (uint32_t mask: {colorMasks.red, colorMasks.green, colorMasks.blue, colorMasks.alpha}) {
+            uint32_t lowestBit = mask & (~mask + 1);
+            if ((mask + lowestBit) & mask)
+                throw std::runtime_error("Error: bitfield masks are corrupted!");
+        }
+        return masksAfterHeader;
     }
 
-    void fillPalette(const std::vector<char> &bytes) {
-        uint32_t offsetToPalette = BITMAP_FILE_HEADER_SIZE + BITMAP_INFO_HEADER_SIZE;
-        uint32_t colorTableSize = (fileHeader.offsetToImageData - offsetToPalette) / BITMAP_RGBQUAD_SIZE;
+    void fillPalette(const std::vector<char> &bytes, uint32_t masksAfterHeader) {
+        uint32_t offsetToPalette = BITMAP_FILE_HEADER_SIZE + headerSize + masksAfterHeader;
+        uint32_t entrySize = headerSize == BITMAP_CORE_HEADER_SIZE ? BITMAP_RGBTRIPLE_SIZE : BITMAP_RGBQUAD_SIZE;
+        uint32_t paletteEnd = std::min<uint64_t>(fileHeader.offsetToImageData, bytes.size());
+        uint32_t colorTableSize = paletteEnd > offsetToPalette ? (paletteEnd - offsetToPalette) / entrySize : 0;
+        if (infoHeader.bitCount > 8)
+            colorTableSize = std::min<uint32_t>(colorTableSize, uint32_t(infoHeader.colorsInColorTable));
+        else
+            colorTableSize = std::min(colorTableSize, 1u << infoHeader.bitCount);
         for (uint32_t i = 0; i < colorTableSize; ++i) {
             RGBQuad color{};
-            memcpy(&color, &bytes[offsetToPalette + i * BITMAP_RGBQUAD_SIZE], BITMAP_RGBQUAD_SIZE);
+            memcpy(&color, &bytes[offsetToPalette + i * entrySize], BITMAP_RGBTRIPLE_SIZE);
             this->palette.push_back(color);
         }
     }
 
+    void decodeIndexedRow(const uint8_t *source, std::vector<RGBA> &row, const RGBA (&colors)[256]) const {
+        const uint32_t bitCount = this->infoHeader.bitCount;
+        if (bitCount == 8) {
+            for (int32_t column = 0; column < this->width; ++column)
+                row[column] = colors[source[column]];
+            return;
+        }
+        const uint32_t pixelsPerByte = 8 / bitCount;
+        const uint8_t indexMask = (1 << bitCount) - 1;
+        for (int32_t column = 0; column < this->width; ++column) {
+            uint32_t shift = 8 - bitCount * (column % pixelsPerByte + 1);
+            row[column] = colors[(source[column / pixelsPerByte] >> shift) & indexMask];
+        }
+    }
+
+    // A plain byte shuffle; whether the 3-byte stride gets vectorized is left to the compiler and target.
+    void decodeRow24(const uint8_t *source, std::vector<RGBA> &row) const {
+        RGBA *target = row.data();
+        for (int32_t column = 0; column < this->width; ++column) {
+            target[column].red = source[3 * column + 2];
+            target[column].green = source[3 * column + 1];
+            target[column].blue = source[3 * column];
+            target[column].alpha = 0;
+        }
+    }
+
+    // Byte-aligned 8-bit masks in BGR(A) order are a plain byte shuffle.
+    void decodeRow32(const uint8_t *source, std::vector<RGBA> &row) const {
+        const uint8_t alphaMask = this->colorMasks.alpha == 0 ? 0x00 : 0xFF;
+        RGBA *target = row.data();
+        for (int32_t column = 0; column < this->width; ++column) {
+            target[column].red = source[4 * column + 2];
+            target[column].green = source[4 * column + 1];
+            target[column].blue = source[4 * column];
+            target[column].alpha = source[4 * column + 3] & alphaMask;
+        }
+    }
+
+    // 5-6-5 and 5-5-5 pixels are expanded with shifts and a multiply-scale instead of the lookup tables, so the
+    // loop vectorizes. (v * 527 + 23) >> 6 and (v * 259 + 33) >> 6 round like v * 255 / 31 and v * 255 / 63.
+    template<uint32_t GREEN_BITS>
+    void decodeRow16(const uint8_t *source, std::vector<RGBA> &row) const {
+        RGBA *target = row.data();
+        for (int32_t column = 0; column < this->width; ++column) {
+            uint32_t pixel = source[2 * column] | (source[2 * column + 1] << 8);
+            uint32_t red = (pixel >> (5 + GREEN_BITS)) & 0x1F;
+            uint32_t green = (pixel >> 5) & ((1u << GREEN_BITS) - 1);
+            uint32_t blue = pixel & 0x1F;
+            target[column].red = static_cast<uint8_t>((red * 527 + 23) >> 6);
+            target[column].green = static_cast<uint8_t>(GREEN_BITS == 6 ? (green * 259 + 33) >> 6
+                                                                         : (green * 527 + 23) >> 6);
+            target[column].blue = static_cast<uint8_t>((blue * 527 + 23) >> 6);
+            target[column].alpha = 0;
+        }
+    }
+
+    void decodeBitfieldsRow(const uint8_t *source, std::vector<RGBA> &row, const ChannelMask (&channels)[4]) const {
+        const uint32_t bytesPerPixel = this->infoHeader.bitCount / 8;
+        for (int32_t column = 0; column < this->width; ++column) {
+            uint32_t pixel = 0;
+            memcpy(&pixel, source + column * bytesPerPixel, bytesPerPixel);
+            row[column].red = channels[0].extract(pixel);
+            row[column].green = channels[1].extract(pixel);
+            row[column].blue = channels[2].extract(pixel);
+            row[column].alpha = channels[3].extract(pixel);
+        }
+    }
+
     void fillPixels(const std::vector<char> &bytes) {
         this->width = this->infoHeader.width;
-        this->height = this->infoHeader.height;
+        this->topDown = this->infoHeader.height < 0;
+        this->height = std::abs(this->infoHeader.height);
+        uint64_t bitWidth = uint64_t(this->width) * this->infoHeader.bitCount;
+        uint64_t bytesPerLine = (((bitWidth + 31) / 32) * 4);
+        if (this->fileHeader.offsetToImageData + bytesPerLine * this->height > bytes.size())
+            throw std::runtime_error("Error: image data is corrupted!");
+
+        RGBA colors[256]{};
+        for (uint32_t i = 0; i < std::min<size_t>(this->palette.size(), 256); ++i)
+            colors[i] = RGBA{this->palette[i].rgbRed, this->palette[i].rgbGreen, this->palette[i].rgbBlue, 0};
+        const ChannelMask channels[4] = {ChannelMask(this->colorMasks.red), ChannelMask(this->colorMasks.green),
+                                         ChannelMask(this->colorMasks.blue), ChannelMask(this->colorMasks.alpha)};
+        const bool masks555 = this->colorMasks.red == 0x7C00 && this->colorMasks.green == 0x03E0 &&
+                              this->colorMasks.blue == 0x001F && this->colorMasks.alpha == 0;
+        const bool masks565 = this->colorMasks.red == 0xF800 && this->colorMasks.green == 0x07E0 &&
+                              this->colorMasks.blue == 0x001F && this->colorMasks.alpha == 0;
+        const bool standardMasks = this->colorMasks.red == 0x00FF0000 && this->colorMasks.green == 0x0000FF00 &&
+                                   this->colorMasks.blue == 0x000000FF &&
+                                   (this->colorMasks.alpha == 0 || this->colorMasks.alpha == 0xFF000000);
+
+        const auto *imageData = reinterpret_cast<const uint8_t *>(&bytes[this->fileHeader.offsetToImageData]);
         this->pixels = std::vector<std::vector<RGBA>>(this->height);
-        auto imageData = std::vector(bytes.begin() + this->fileHeader.offsetToImageData, bytes.end());
-        uint32_t bitWidth = this->width * this->infoHeader.bitCount;
-        uint32_t bytesPerLine = (((bitWidth + 31) / 32) * 4);
-        for (uint32_t row = 0; row < this->height;++row){
-            this->pixels[row] = std::vector<RGBA>(this->width);
-            for (uint32_t offset = 0, column=0; offset < bitWidth;++column){
-                uint32_t pixelData = 0;
-                for (uint32_t bitLeft = this->infoHeader.bitCount, bitsRead; bitLeft != 0; bitLeft -= bitsRead){
-                    uint8_t buffer = 0;
-                    uint8_t offsetBit = offset%8;
-                    bitsRead = std::min(uint32_t(8 - offsetBit), bitLeft);
-                    buffer = imageData[row*bytesPerLine+offset/8];
-                    if (offsetBit)
-                        buffer = char(buffer & ((1 << bitsRead) - 1));
-                    if ((offset%8 + bitLeft) < 8)
-                        buffer = char(buffer >> (8 - (offsetBit + bitLeft)));
-                    pixelData = (pixelData << bitsRead) | (uint8_t)buffer;
-                    offset += bitsRead;
-                }
-                if (this->infoHeader.bitCount == 8){
-                    this->pixels[row][column].red=this->palette[pixelData].rgbRed;
-                    this->pixels[row][column].green=this->palette[pixelData].rgbGreen;
-                    this->pixels[row][column].blue=this->palette[pixelData].rgbBlue;
-                } else
-                    throw std::runtime_error("Unsupported format!");
-            }
+        for (int32_t fileRow = 0; fileRow < this->height; ++fileRow) {
+            const uint8_t *source = imageData + fileRow * bytesPerLine;
+            auto &row = this->pixels[this->topDown ? fileRow : this->height - 1 - fileRow];
+            row = std::vector<RGBA>(this->width);
+            if (this->infoHeader.bitCount <= 8)
+                decodeIndexedRow(source, row, colors);
+            else if (this->infoHeader.bitCount == 24)
+                decodeRow24(source, row);
+            else if (this->infoHeader.bitCount == 16 && masks555)
+                decodeRow16<5>(source, row);
+            else if (this->infoHeader.bitCount == 16 && masks565)
+                decodeRow16<6>(source, row);
+            else if (this->infoHeader.bitCount == 32 && standardMasks)
+                decodeRow32(source, row);
+            else
+                decodeBitfieldsRow(source, row, channels);
         }
-        std::reverse(this->pixels.begin(), this->pixels.end());
     }
 
 public:
-    explicit Bitmap(const std::vector<char> &bytes) : fileHeader({}), infoHeader({}) {
+    explicit Bitmap(const std::vector<char> &bytes) : fileHeader({}), infoHeader({}), colorMasks({}) {
         fillFileHeader(bytes);
         fillInfoHeader(bytes);
-        fillPalette(bytes);
+        fillPalette(bytes, fillColorMasks(bytes));
         fillPixels(bytes);
     }
 
@@ -139,6 +334,10 @@ public:
         return infoHeader;
     }
 
+    [[nodiscard]] const BitmapColorMasks &getColorMasks() const {
+        return colorMasks;
+    }
+
     [[nodiscard]] const std::vector<RGBQuad> &getPalette() const {
         return palette;
     }
@@ -154,6 +353,10 @@ public:
     [[nodiscard]] int32_t getHeight() const {
         return height;
     }
+
+    [[nodiscard]] bool isTopDown() const {
+        return topDown;
+    }
 };
 
 #endif
\ No newline at end of file
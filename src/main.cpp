@@ -3,6 +3,7 @@
 #include <fstream>
 #include <image_types/Bitmap.h>
 #include <image_formats/pcx/PCXPalette16Color.h>
+#include <image_formats/pcx/PCXPalette16ColorSequence.h>
 
 std::vector<char> readAllBytes(const std::string &path) {
     std::ifstream file(path, std::ios::binary | std::ios::ate);
@@ -58,11 +59,36 @@ void showPixels(const std::vector<std::vector<RGBA>>& pixels){
     }
 }
 
+DitheringMode parseDitheringMode(int argc, char* argv[]) {
+    if (argc < 3)
+        return DitheringMode::NONE;
+    std::string option(argv[2]);
+    if (option == "--dither=ordered")
+        return DitheringMode::ORDERED;
+    if (option == "--dither=floyd-steinberg")
+        return DitheringMode::FLOYD_STEINBERG;
+    throw std::runtime_error("Error: unknown option " + option + "!");
+}
+
+int convertSequence(int argc, char* argv[]) {
+    PCXPalette16ColorSequence sequence;
+    for (int frame = 2; frame < argc; ++frame) {
+        Bitmap bitmap(readAllBytes(argv[frame]));
+        auto image = sequence.encodeFrame(bitmap.getPixels());
+        std::cout << argv[frame] << ": " << sequence.getChangedScanlines() << " of " << bitmap.getHeight()
+                  << " scanlines encoded" << std::endl;
+        saveBytesToFile(image,std::string("16color[")+argv[frame]+"].pcx");
+    }
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--sequence")
+        return convertSequence(argc, argv);
     auto bytes = readAllBytes(argv[1]);
     Bitmap bitmap(bytes);
     showPixels(bitmap.getPixels());
-    PCXPalette16Color palette16Color;
+    PCXPalette16Color palette16Color(parseDitheringMode(argc, argv));
     std::vector<char> image(PCX::PCX_HEADER_SIZE);
     auto header = palette16Color.generateHeader(bitmap.getPixels());
     memcpy(&image[0],&header,PCX::PCX_HEADER_SIZE);